@@ -0,0 +1,794 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include <v853_cam_intf.h>
+
+#define BENCH_REQ_BUF_COUNT 3
+#define BENCH_WRITE_FRAMES  30
+#define BENCH_WRITE_BUF     (1024 * 1024)
+#define BENCH_MAX_REPS      32
+#define BENCH_WARMUP_FRAMES 10
+
+enum metric_dir {
+    HIGHER_IS_BETTER = 0,
+    LOWER_IS_BETTER,
+};
+
+struct bench_metric {
+    const char *name;
+    int dir;
+    int gate;         /* counted as a regression by compare_baseline */
+    double threshold; /* default regression threshold in percent */
+    double value;
+};
+
+enum {
+    M_COPY_MBPS = 0,
+    M_CONVERT_FPS,
+    M_WRITE_PER_FRAME_FPS,
+    M_WRITE_BATCHED_FPS,
+    M_E2E_FPS,
+    M_E2E_LAT_P50,
+    M_E2E_LAT_P90,
+    M_E2E_LAT_P99,
+    M_E2E_LAT_MAX,
+    M_NUM,
+};
+
+static struct bench_metric metrics[M_NUM] = {
+    /* memory bandwidth and page cache share the host, tail latency is noisiest */
+    [M_COPY_MBPS]           = {"copy_mbps", HIGHER_IS_BETTER, 1, 25},
+    [M_CONVERT_FPS]         = {"convert_fps", HIGHER_IS_BETTER, 1, 20},
+    [M_WRITE_PER_FRAME_FPS] = {"write_per_frame_fps", HIGHER_IS_BETTER, 1, 30},
+    [M_WRITE_BATCHED_FPS]   = {"write_batched_fps", HIGHER_IS_BETTER, 1, 30},
+    [M_E2E_FPS]             = {"e2e_fps", HIGHER_IS_BETTER, 1, 10},
+    [M_E2E_LAT_P50]         = {"e2e_lat_p50_us", LOWER_IS_BETTER, 1, 25},
+    [M_E2E_LAT_P90]         = {"e2e_lat_p90_us", LOWER_IS_BETTER, 1, 30},
+    [M_E2E_LAT_P99]         = {"e2e_lat_p99_us", LOWER_IS_BETTER, 1, 50},
+    /* a single sample, reported only */
+    [M_E2E_LAT_MAX]         = {"e2e_lat_max_us", LOWER_IS_BETTER, 0, 0},
+};
+
+struct bench_cfg {
+    const char *dev_name; /* NULL runs against the software frame source */
+    const char *out_file;
+    const char *baseline;
+    const char *tmp_dir;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps;   /* software source rate, 0 = as fast as possible */
+    int frames;     /* end-to-end frames per repetition */
+    int iterations; /* micro benchmark iterations per repetition */
+    int reps;       /* timed repetitions, the median is reported */
+    int warmup;     /* untimed repetitions before the timed ones */
+    double threshold; /* overrides the per-metric thresholds when > 0 */
+    int yuv;
+};
+
+/*
+ * software frame source, stands in for /dev/videoN
+ */
+struct soft_source {
+    uint8_t *frame;
+    size_t size;
+    uint32_t width;
+    uint32_t height;
+    uint64_t period_us;
+    uint64_t next_us;
+    uint32_t seq;
+};
+
+static void soft_fill(struct soft_source *src)
+{
+    uint32_t y_size = src->width * src->height;
+    uint32_t x, y;
+
+    /* moving gradient, keeps the data from being trivially compressible */
+    for (y = 0; y < src->height; y++)
+        for (x = 0; x < src->width; x++)
+            src->frame[y * src->width + x] = (uint8_t)(x + y + src->seq);
+    memset(src->frame + y_size, 0x80 + (src->seq & 0x3f), y_size / 2);
+}
+
+static int soft_init(struct soft_source *src, uint32_t width, uint32_t height, uint32_t fps)
+{
+    memset(src, 0, sizeof(*src));
+    src->width  = width;
+    src->height = height;
+    src->size   = width * height * 3 / 2;
+    src->frame  = malloc(src->size);
+    if (src->frame == NULL)
+        return -1;
+
+    src->period_us = fps ? 1000000 / fps : 0;
+    src->next_us   = camera_now_us();
+    return 0;
+}
+
+static int soft_cap_frame(struct soft_source *src, uint8_t *img_buf, int *img_size, uint64_t *ts_us)
+{
+    struct timespec ts;
+    uint64_t now = camera_now_us();
+
+    /* wait for the next frame period like a sensor would */
+    if (src->period_us)
+    {
+        if (now < src->next_us)
+        {
+            ts.tv_sec  = src->next_us / 1000000;
+            ts.tv_nsec = (src->next_us % 1000000) * 1000;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+        *ts_us = src->next_us;
+        src->next_us += src->period_us;
+    }
+    else
+    {
+        *ts_us = now;
+    }
+
+    src->seq++;
+    soft_fill(src);
+    memcpy(img_buf, src->frame, src->size);
+    *img_size = src->size;
+
+    return 0;
+}
+
+/*
+ * I420 to RGB24, BT.601 integer approximation
+ */
+static void i420_to_rgb24(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t height)
+{
+    const uint8_t *py = src;
+    const uint8_t *pu = src + width * height;
+    const uint8_t *pv = pu + width * height / 4;
+    uint32_t x, y;
+    int c, d, e, r, g, b;
+
+    for (y = 0; y < height; y++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            c = py[y * width + x] - 16;
+            d = pu[(y / 2) * (width / 2) + x / 2] - 128;
+            e = pv[(y / 2) * (width / 2) + x / 2] - 128;
+
+            r = (298 * c + 409 * e + 128) >> 8;
+            g = (298 * c - 100 * d - 208 * e + 128) >> 8;
+            b = (298 * c + 516 * d + 128) >> 8;
+
+            *dst++ = r < 0 ? 0 : (r > 255 ? 255 : r);
+            *dst++ = g < 0 ? 0 : (g > 255 ? 255 : g);
+            *dst++ = b < 0 ? 0 : (b > 255 ? 255 : b);
+        }
+    }
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static double median(double *v, int n)
+{
+    qsort(v, n, sizeof(*v), cmp_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+/*
+ * copy out of a mapped buffer, the same memcpy camera_cap_image does
+ * args:
+ *   map - mapped capture buffer, or NULL to map an anonymous shared one
+ */
+static int bench_copy(struct bench_cfg *cfg, void *map, size_t size)
+{
+    double samples[BENCH_MAX_REPS];
+    uint8_t *dst;
+    uint64_t start, elapsed;
+    int own = 0;
+    int rc  = -1;
+    int r, i;
+
+    if (map == NULL)
+    {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED)
+        {
+            perror("mmap ");
+            return -1;
+        }
+        memset(map, 0x5a, size);
+        own = 1;
+    }
+
+    dst = malloc(size);
+    if (dst == NULL)
+        goto UNMAP;
+
+    /* negative r are warm-up rounds */
+    for (r = -cfg->warmup; r < cfg->reps; r++)
+    {
+        start = camera_now_us();
+        for (i = 0; i < cfg->iterations; i++)
+            memcpy(dst, map, size);
+        elapsed = camera_now_us() - start;
+        if (r >= 0)
+            samples[r] = elapsed ? (double)size * cfg->iterations / elapsed : 0;
+    }
+
+    metrics[M_COPY_MBPS].value = median(samples, cfg->reps);
+    free(dst);
+    rc = 0;
+
+UNMAP:
+    if (own)
+        munmap(map, size);
+
+    return rc;
+}
+
+static int bench_convert(struct bench_cfg *cfg)
+{
+    double samples[BENCH_MAX_REPS];
+    struct soft_source src;
+    uint8_t *rgb;
+    uint64_t start, elapsed;
+    int r, i;
+
+    if (soft_init(&src, cfg->width, cfg->height, 0) < 0)
+        return -1;
+    soft_fill(&src);
+
+    rgb = malloc(cfg->width * cfg->height * 3);
+    if (rgb == NULL)
+    {
+        free(src.frame);
+        return -1;
+    }
+
+    for (r = -cfg->warmup; r < cfg->reps; r++)
+    {
+        start = camera_now_us();
+        for (i = 0; i < cfg->iterations; i++)
+            i420_to_rgb24(src.frame, rgb, cfg->width, cfg->height);
+        elapsed = camera_now_us() - start;
+        if (r >= 0)
+            samples[r] = elapsed ? cfg->iterations * 1000000.0 / elapsed : 0;
+    }
+
+    metrics[M_CONVERT_FPS].value = median(samples, cfg->reps);
+
+    free(rgb);
+    free(src.frame);
+    return 0;
+}
+
+/*
+ * per-frame fopen/fwrite/fclose as main() does
+ * returns - frames per second, -1 on error
+ */
+static double write_per_frame(struct bench_cfg *cfg, struct soft_source *src)
+{
+    char file_name[256];
+    uint64_t start, elapsed;
+    FILE *fp;
+    int i;
+
+    start = camera_now_us();
+    for (i = 0; i < BENCH_WRITE_FRAMES; i++)
+    {
+        snprintf(file_name, sizeof(file_name), "%s/bench_img%02d.yuv", cfg->tmp_dir, i);
+        fp = fopen(file_name, "w");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "can't open %s\n", file_name);
+            return -1;
+        }
+        fwrite(src->frame, src->size, 1, fp);
+        fclose(fp);
+    }
+    elapsed = camera_now_us() - start;
+
+    for (i = 0; i < BENCH_WRITE_FRAMES; i++)
+    {
+        snprintf(file_name, sizeof(file_name), "%s/bench_img%02d.yuv", cfg->tmp_dir, i);
+        unlink(file_name);
+    }
+
+    return elapsed ? BENCH_WRITE_FRAMES * 1000000.0 / elapsed : 0;
+}
+
+/*
+ * all frames into one fully buffered file
+ * returns - frames per second, -1 on error
+ */
+static double write_batched(struct bench_cfg *cfg, struct soft_source *src, char *vbuf)
+{
+    char file_name[256];
+    uint64_t start, elapsed;
+    FILE *fp;
+    int i;
+
+    snprintf(file_name, sizeof(file_name), "%s/bench_batch.yuv", cfg->tmp_dir);
+    start = camera_now_us();
+    fp    = fopen(file_name, "w");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "can't open %s\n", file_name);
+        return -1;
+    }
+    setvbuf(fp, vbuf, _IOFBF, BENCH_WRITE_BUF);
+    for (i = 0; i < BENCH_WRITE_FRAMES; i++)
+        fwrite(src->frame, src->size, 1, fp);
+    fclose(fp);
+    elapsed = camera_now_us() - start;
+
+    unlink(file_name);
+
+    return elapsed ? BENCH_WRITE_FRAMES * 1000000.0 / elapsed : 0;
+}
+
+static int bench_write(struct bench_cfg *cfg)
+{
+    double per_frame[BENCH_MAX_REPS];
+    double batched[BENCH_MAX_REPS];
+    struct soft_source src;
+    double fps;
+    char *vbuf;
+    int rc = -1;
+    int r;
+
+    if (soft_init(&src, cfg->width, cfg->height, 0) < 0)
+        return -1;
+    soft_fill(&src);
+
+    vbuf = malloc(BENCH_WRITE_BUF);
+    if (vbuf == NULL)
+        goto FREE_FRAME;
+
+    for (r = -cfg->warmup; r < cfg->reps; r++)
+    {
+        fps = write_per_frame(cfg, &src);
+        if (fps < 0)
+            goto FREE_VBUF;
+        if (r >= 0)
+            per_frame[r] = fps;
+
+        fps = write_batched(cfg, &src, vbuf);
+        if (fps < 0)
+            goto FREE_VBUF;
+        if (r >= 0)
+            batched[r] = fps;
+    }
+
+    metrics[M_WRITE_PER_FRAME_FPS].value = median(per_frame, cfg->reps);
+    metrics[M_WRITE_BATCHED_FPS].value   = median(batched, cfg->reps);
+    rc = 0;
+
+FREE_VBUF:
+    free(vbuf);
+FREE_FRAME:
+    free(src.frame);
+
+    return rc;
+}
+
+/*
+ * capture -> copy-out latency and sustained fps
+ * args:
+ *   camera - started camera, or NULL for the software source
+ *
+ * The software source only times frame generation and memcpy, it does not
+ * go through camera_cap_frame.
+ */
+static int bench_e2e(struct bench_cfg *cfg, camera_handle *camera)
+{
+    double fps[BENCH_MAX_REPS];
+    double p50[BENCH_MAX_REPS];
+    double p90[BENCH_MAX_REPS];
+    double p99[BENCH_MAX_REPS];
+    struct soft_source src;
+    uint64_t *lat;
+    uint64_t start, elapsed, ts_us, now;
+    uint64_t lat_max = 0;
+    uint8_t *img_buf;
+    size_t size;
+    int img_size;
+    int rc = 0;
+    int r, n;
+
+    if (camera == NULL)
+    {
+        if (soft_init(&src, cfg->width, cfg->height, cfg->fps) < 0)
+            return -1;
+        size = src.size;
+    }
+    else
+    {
+        src.frame = NULL;
+        size      = camera->buffers[0].length[0];
+    }
+
+    img_buf = malloc(size);
+    lat     = calloc(cfg->frames, sizeof(*lat));
+    if (img_buf == NULL || lat == NULL)
+    {
+        rc = -1;
+        goto FREE_BUF;
+    }
+
+    /* r == -1 is the warm-up round, it only runs a few frames */
+    for (r = cfg->warmup ? -1 : 0; r < cfg->reps; r++)
+    {
+        start = camera_now_us();
+        for (n = 0; n < (r < 0 ? BENCH_WARMUP_FRAMES * cfg->warmup : cfg->frames); n++)
+        {
+            if (camera)
+                rc = camera_cap_frame(camera, img_buf, &img_size, &ts_us, 2);
+            else
+                rc = soft_cap_frame(&src, img_buf, &img_size, &ts_us);
+            if (rc < 0)
+            {
+                fprintf(stderr, "get image failed!\n");
+                goto FREE_BUF;
+            }
+
+            /* buffer timestamps are CLOCK_MONOTONIC, same as camera_now_us */
+            now = camera_now_us();
+            if (r >= 0)
+                lat[n] = now > ts_us ? now - ts_us : 0;
+        }
+        elapsed = camera_now_us() - start;
+        if (r < 0)
+            continue;
+
+        qsort(lat, n, sizeof(*lat), cmp_u64);
+        fps[r] = elapsed ? n * 1000000.0 / elapsed : 0;
+        p50[r] = lat[n * 50 / 100];
+        p90[r] = lat[n * 90 / 100];
+        p99[r] = lat[n * 99 / 100];
+        if (lat[n - 1] > lat_max)
+            lat_max = lat[n - 1];
+    }
+
+    metrics[M_E2E_FPS].value     = median(fps, cfg->reps);
+    metrics[M_E2E_LAT_P50].value = median(p50, cfg->reps);
+    metrics[M_E2E_LAT_P90].value = median(p90, cfg->reps);
+    metrics[M_E2E_LAT_P99].value = median(p99, cfg->reps);
+    metrics[M_E2E_LAT_MAX].value = lat_max;
+
+FREE_BUF:
+    free(lat);
+    free(img_buf);
+    free(src.frame);
+
+    return rc < 0 ? -1 : 0;
+}
+
+static const char *bench_source(struct bench_cfg *cfg)
+{
+    return cfg->dev_name ? cfg->dev_name : "soft";
+}
+
+/* soft: e2e times frame generation + memcpy, not the V4L2 capture path */
+static const char *bench_e2e_path(struct bench_cfg *cfg)
+{
+    return cfg->dev_name ? "camera_cap_frame" : "soft_source";
+}
+
+static void write_json(FILE *fp, struct bench_cfg *cfg)
+{
+    int i;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"source\": \"%s\",\n", bench_source(cfg));
+    fprintf(fp, "  \"e2e_path\": \"%s\",\n", bench_e2e_path(cfg));
+    fprintf(fp, "  \"width\": %u,\n", cfg->width);
+    fprintf(fp, "  \"height\": %u,\n", cfg->height);
+    fprintf(fp, "  \"frames\": %d,\n", cfg->frames);
+    fprintf(fp, "  \"iterations\": %d,\n", cfg->iterations);
+    fprintf(fp, "  \"reps\": %d,\n", cfg->reps);
+    fprintf(fp, "  \"warmup\": %d,\n", cfg->warmup);
+    fprintf(fp, "  \"results\": {\n");
+    for (i = 0; i < M_NUM; i++)
+        fprintf(fp, "    \"%s\": %.2f%s\n", metrics[i].name, metrics[i].value, i == M_NUM - 1 ? "" : ",");
+    fprintf(fp, "  }\n");
+    fprintf(fp, "}\n");
+}
+
+/*
+ * find the value of a top level field in a JSON file written by write_json
+ * returns - pointer to the first character of the value, NULL if missing
+ */
+static const char *json_field(const char *text, const char *name)
+{
+    char key[64];
+    const char *p;
+
+    snprintf(key, sizeof(key), "\"%s\":", name);
+    p = strstr(text, key);
+    if (p == NULL)
+        return NULL;
+    for (p += strlen(key); *p == ' ' || *p == '\t'; p++)
+        ;
+
+    return p;
+}
+
+/*
+ * check that a string field of the baseline matches the current run
+ * returns - 1 if it matches, 0 otherwise
+ */
+static int baseline_match_str(const char *text, const char *name, const char *cur)
+{
+    const char *p = json_field(text, name);
+    size_t len = strlen(cur);
+
+    if (p && *p == '"' && strncmp(p + 1, cur, len) == 0 && p[1 + len] == '"')
+        return 1;
+
+    fprintf(stderr, "baseline %s differs, current run: \"%s\"\n", name, cur);
+    return 0;
+}
+
+static int baseline_match_num(const char *text, const char *name, uint32_t cur)
+{
+    const char *p = json_field(text, name);
+
+    if (p && strtoul(p, NULL, 10) == cur)
+        return 1;
+
+    fprintf(stderr, "baseline %s differs, current run: %u\n", name, cur);
+    return 0;
+}
+
+/*
+ * compare against a JSON file written by a previous run
+ *
+ * Numbers from a different source or resolution are not comparable, they are
+ * printed but nothing is gated. The soft source e2e numbers time frame
+ * generation rather than camera_cap_frame and are never gated either.
+ *
+ * returns - number of gated metrics worse than the threshold, -1 on error
+ */
+static int compare_baseline(struct bench_cfg *cfg)
+{
+    const char *p;
+    char *text;
+    double base, diff, limit;
+    long len;
+    FILE *fp;
+    int regressions = 0;
+    int same_run;
+    int gate;
+    int bad;
+    int i;
+
+    fp = fopen(cfg->baseline, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "can't open baseline %s\n", cfg->baseline);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    text = calloc(1, len + 1);
+    if (text == NULL || fread(text, 1, len, fp) != (size_t)len)
+    {
+        fprintf(stderr, "read baseline %s failed!\n", cfg->baseline);
+        free(text);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    fprintf(stderr, "baseline: %s\n", cfg->baseline);
+    same_run  = baseline_match_str(text, "source", bench_source(cfg));
+    same_run &= baseline_match_str(text, "e2e_path", bench_e2e_path(cfg));
+    same_run &= baseline_match_num(text, "width", cfg->width);
+    same_run &= baseline_match_num(text, "height", cfg->height);
+    if (!same_run)
+        fprintf(stderr, "baseline was recorded with a different setup, nothing is gated\n");
+
+    for (i = 0; i < M_NUM; i++)
+    {
+        gate = metrics[i].gate && same_run;
+        if (i >= M_E2E_FPS && cfg->dev_name == NULL)
+            gate = 0;
+
+        p = json_field(text, metrics[i].name);
+        if (p == NULL)
+        {
+            fprintf(stderr, "  %-20s %12.2f  (no baseline)\n", metrics[i].name, metrics[i].value);
+            continue;
+        }
+        base = strtod(p, NULL);
+        if (base == 0)
+        {
+            fprintf(stderr, "  %-20s %12.2f  (baseline 0)\n", metrics[i].name, metrics[i].value);
+            continue;
+        }
+
+        /* positive diff is always an improvement */
+        diff = (metrics[i].value - base) * 100.0 / base;
+        if (metrics[i].dir == LOWER_IS_BETTER)
+            diff = -diff;
+
+        limit = cfg->threshold > 0 ? cfg->threshold : metrics[i].threshold;
+        bad   = diff < -limit;
+        fprintf(stderr, "  %-20s %12.2f  base %12.2f  %+7.1f%% (limit -%.0f%%)%s\n", metrics[i].name,
+                metrics[i].value, base, diff, limit,
+                bad ? (gate ? "  REGRESSION" : "  (not gated)") : "");
+        if (bad && gate)
+            regressions++;
+    }
+
+    free(text);
+    return regressions;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [options]\n", prog);
+    fprintf(stderr, "  -d dev     capture from /dev/videoN instead of the software source\n");
+    fprintf(stderr, "  -y         request YUV420 from the camera instead of MJPEG\n");
+    fprintf(stderr, "  -W width   software source width (default 1920)\n");
+    fprintf(stderr, "  -H height  software source height (default 1088)\n");
+    fprintf(stderr, "  -f fps     software source rate, 0 = unthrottled (default 30)\n");
+    fprintf(stderr, "  -n frames  end-to-end frames per repetition (default 120)\n");
+    fprintf(stderr, "  -i iter    micro benchmark iterations per repetition (default 20)\n");
+    fprintf(stderr, "  -R reps    timed repetitions, the median is reported (default 5, max %d)\n", BENCH_MAX_REPS);
+    fprintf(stderr, "  -w rounds  untimed warm-up rounds (default 1)\n");
+    fprintf(stderr, "  -t dir     directory for the write benchmark (default /tmp)\n");
+    fprintf(stderr, "  -o file    write the JSON result to file instead of stdout\n");
+    fprintf(stderr, "  -b file    compare with a baseline JSON from a previous run\n");
+    fprintf(stderr, "  -r pct     regression threshold in percent for every metric\n");
+    fprintf(stderr, "             (default: per metric, 10%% for e2e_fps up to 50%% for p99)\n");
+    fprintf(stderr, "stdout carries only the JSON result, diagnostics go to stderr.\n");
+    fprintf(stderr, "without -d the end-to-end numbers time the software source (frame\n");
+    fprintf(stderr, "generation + memcpy), not camera_cap_frame; use -d /dev/videoN (vivid\n");
+    fprintf(stderr, "works) to cover the capture path; only then are they gated by -b.\n");
+    fprintf(stderr, "-b gates nothing when the baseline source, e2e_path, width or height\n");
+    fprintf(stderr, "differ from the current run.\n");
+    fprintf(stderr, "record a baseline with '-o baseline.json', check it later with '-b baseline.json'\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_cfg cfg;
+    camera_handle camera;
+    camera_handle *cam = NULL;
+    FILE *json;
+    int json_fd;
+    int regressions = 0;
+    int opt;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.width      = 1920;
+    cfg.height     = 1088;
+    cfg.fps        = 30;
+    cfg.frames     = 120;
+    cfg.iterations = 20;
+    cfg.reps       = 5;
+    cfg.warmup     = 1;
+    cfg.tmp_dir    = "/tmp";
+
+    while ((opt = getopt(argc, argv, "d:yW:H:f:n:i:R:w:t:o:b:r:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd': cfg.dev_name = optarg; break;
+        case 'y': cfg.yuv = 1; break;
+        case 'W': cfg.width = strtoul(optarg, NULL, 0); break;
+        case 'H': cfg.height = strtoul(optarg, NULL, 0); break;
+        case 'f': cfg.fps = strtoul(optarg, NULL, 0); break;
+        case 'n': cfg.frames = atoi(optarg); break;
+        case 'i': cfg.iterations = atoi(optarg); break;
+        case 'R': cfg.reps = atoi(optarg); break;
+        case 'w': cfg.warmup = atoi(optarg); break;
+        case 't': cfg.tmp_dir = optarg; break;
+        case 'o': cfg.out_file = optarg; break;
+        case 'b': cfg.baseline = optarg; break;
+        case 'r': cfg.threshold = atof(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+    if (cfg.width == 0 || cfg.height == 0 || cfg.frames <= 0 || cfg.iterations <= 0 ||
+        cfg.reps <= 0 || cfg.reps > BENCH_MAX_REPS || cfg.warmup < 0)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    /*
+     * keep stdout for the JSON only, the library reports through printf
+     */
+    fflush(stdout);
+    json_fd = dup(STDOUT_FILENO);
+    if (json_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+    {
+        perror("dup ");
+        return -1;
+    }
+
+    if (cfg.dev_name)
+    {
+        memset(&camera, 0, sizeof(camera));
+        camera.dev_name  = cfg.dev_name;
+        camera.pixel_fmt = cfg.yuv ? V4L2_PIX_FMT_YUV420 : V4L2_PIX_FMT_MJPEG;
+        camera.buf_cnt   = BENCH_REQ_BUF_COUNT;
+        if (camera_init(&camera) < 0 || camera_start(&camera) < 0)
+            return -1;
+        cam = &camera;
+
+        /* real frame geometry for the conversion and write benchmarks */
+        cfg.width  = camera.width;
+        cfg.height = camera.height;
+    }
+
+    if (bench_copy(&cfg, cam ? cam->buffers[0].start[0] : NULL,
+                   cam ? cam->buffers[0].length[0] : cfg.width * cfg.height * 3 / 2) < 0)
+        fprintf(stderr, "copy benchmark failed!\n");
+    if (bench_convert(&cfg) < 0)
+        fprintf(stderr, "convert benchmark failed!\n");
+    if (bench_write(&cfg) < 0)
+        fprintf(stderr, "write benchmark failed!\n");
+    if (bench_e2e(&cfg, cam) < 0)
+        fprintf(stderr, "end-to-end benchmark failed!\n");
+
+    if (cam)
+    {
+        camera_recovery_dump(cam);
+        camera_stop(cam);
+        camera_uninit(cam);
+    }
+    fflush(stdout);
+
+    if (cfg.out_file)
+    {
+        close(json_fd);
+        json = fopen(cfg.out_file, "w");
+    }
+    else
+    {
+        json = fdopen(json_fd, "w");
+    }
+    if (json == NULL)
+    {
+        fprintf(stderr, "can't open %s\n", cfg.out_file ? cfg.out_file : "stdout");
+        return -1;
+    }
+    write_json(json, &cfg);
+    fclose(json);
+
+    if (cfg.baseline)
+    {
+        regressions = compare_baseline(&cfg);
+        if (regressions < 0)
+            return -1;
+        if (regressions)
+            fprintf(stderr, "%d metric(s) regressed!\n", regressions);
+    }
+
+    return regressions ? 2 : 0;
+}
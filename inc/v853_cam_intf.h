@@ -13,7 +13,78 @@ struct buffer {
     size_t length[3];
 };
 
+/* recovery actions, tried from the cheapest to the most expensive */
+enum camera_recover_level {
+    CAM_RECOVER_REQUEUE = 0, /* re-queue buffers the driver no longer owns */
+    CAM_RECOVER_RESTREAM,    /* STREAMOFF/STREAMON, buffers stay mapped */
+    CAM_RECOVER_REOPEN,      /* close, re-init and restart the device */
+    CAM_RECOVER_LEVEL_NUM,
+};
+
+/* zero fields fall back to the defaults in cam_recovery.c */
+struct camera_recovery_cfg {
+    uint32_t max_attempts;   /* consecutive attempts before giving up */
+    uint32_t backoff_ms;     /* delay before the second attempt, doubled after */
+    uint32_t max_backoff_ms; /* upper bound of the delay */
+};
+
+struct camera_recovery_stats {
+    uint32_t recoveries;             /* successful recoveries */
+    uint32_t failures;               /* recoveries that hit max_attempts */
+    uint32_t by_level[CAM_RECOVER_LEVEL_NUM];
+    uint64_t last_recovery_us;       /* first failure -> next good frame */
+    uint64_t last_outage_us;         /* last good frame -> next good frame */
+    uint64_t max_outage_us;
+    uint64_t total_outage_us;
+};
+
+struct camera_recovery {
+    struct camera_recovery_cfg cfg;
+    struct camera_recovery_stats stats;
+    uint32_t attempts;      /* attempts since the last good frame */
+    uint32_t pending_level; /* last action that succeeded, counted on the next frame */
+    uint8_t pending;
+    uint64_t last_frame_us;
+    uint64_t fail_start_us; /* first failure of the current outage, 0 while streaming */
+};
+
+/* cached metadata and value of one V4L2 control */
+struct camera_ctrl {
+    uint32_t id;
+    uint32_t type;
+    uint32_t flags;
+    int64_t minimum;
+    int64_t maximum;
+    uint64_t step;
+    int64_t def;
+    int64_t cur;     /* last value read from or written to the driver */
+    int64_t pending; /* staged by camera_ctrl_set, written on commit */
+    uint8_t valid;   /* cur matches the driver */
+    uint8_t dirty;   /* pending needs to be written */
+    char name[32];
+};
+
+struct camera_ctrl_stats {
+    uint64_t requests; /* camera_ctrl_set calls, one S_CTRL each without batching */
+    uint64_t skipped;  /* requests dropped because the value did not change */
+    uint64_t ioctls;   /* S_EXT_CTRLS actually issued */
+    uint64_t rejected; /* staged values the driver refused, dropped */
+    uint64_t window_start_us; /* requests/ioctls at the start of the rate window */
+    uint64_t window_requests;
+    uint64_t window_ioctls;
+};
+
+struct camera_ctrls {
+    struct camera_ctrl *ctrl; /* sorted by id */
+    struct v4l2_ext_control *batch;
+    uint32_t count;
+    uint32_t n_dirty;
+    int apply_on_frame; /* commit staged values on the next dequeued frame */
+    struct camera_ctrl_stats stats;
+};
+
 typedef struct camera_info {
+    const char *dev_name; /* NULL selects /dev/video0 */
     int cam_fd;
     uint32_t width;
     uint32_t height;
@@ -23,6 +94,8 @@ typedef struct camera_info {
     int driver_type;
     int pixel_fmt;
     struct buffer *buffers;
+    struct camera_recovery recovery;
+    struct camera_ctrls ctrls;
 } camera_handle;
 
 int camera_init(camera_handle *camera);
@@ -30,10 +103,82 @@ int camera_start(camera_handle *camera);
 int camera_stop(camera_handle *camera);
 int camera_uninit(camera_handle *camera);
 int camera_cap_image(camera_handle *camera, uint8_t *img_buf, int *img_size, int timeout);
+int camera_cap_frame(camera_handle *camera, uint8_t *img_buf, int *img_size, uint64_t *ts_us, int timeout);
 int loop_process(camera_handle *camera);
 
+int camera_recover(camera_handle *camera);
+void camera_recovery_frame_ok(camera_handle *camera);
+void camera_recovery_dump(camera_handle *camera);
+
+int camera_ctrl_init(camera_handle *camera);
+void camera_ctrl_uninit(camera_handle *camera);
+struct camera_ctrl *camera_ctrl_find(camera_handle *camera, uint32_t id);
+int camera_ctrl_get(camera_handle *camera, uint32_t id, int64_t *value);
+int camera_ctrl_set(camera_handle *camera, uint32_t id, int64_t value);
+int camera_ctrl_commit(camera_handle *camera);
+int camera_ctrl_frame(camera_handle *camera);
+void camera_ctrl_dump(camera_handle *camera);
+
+int xioctl(int fd, int IOCTL_X, void *arg);
+uint64_t camera_now_us(void);
+
 void show_capabilities(struct v4l2_capability *cap);
 
+#define CAM_SYNC_MAX_CAMS 4
+#define CAM_SYNC_DEPTH    8
+
+/* what happens to a frame still waiting for its partners */
+enum camera_sync_policy {
+    CAM_SYNC_DROP = 0, /* replaced by the next frame of the same camera, lowest latency */
+    CAM_SYNC_HOLD,     /* queued up to CAM_SYNC_DEPTH so a late camera can catch up */
+};
+
+struct camera_sync_frame {
+    uint8_t *data;
+    int size;
+    uint64_t ts_us; /* V4L2 buffer timestamp, CLOCK_MONOTONIC */
+};
+
+struct camera_sync_queue {
+    struct camera_sync_frame slot[CAM_SYNC_DEPTH];
+    size_t slot_size;
+    uint32_t head;
+    uint32_t count;
+    uint64_t frames;  /* frames pushed */
+    uint64_t dropped; /* frames that never made it into a set */
+    uint64_t last_us; /* when camera_sync_capture last got a frame, monotonic */
+};
+
+/* one frame per camera, valid until the next push/capture */
+struct camera_sync_set {
+    struct camera_sync_frame *frame[CAM_SYNC_MAX_CAMS];
+    uint64_t ts_us;   /* oldest timestamp in the set */
+    uint64_t skew_us; /* newest - oldest timestamp */
+};
+
+struct camera_sync_stats {
+    uint64_t sets;
+    uint64_t last_skew_us;
+    uint64_t max_skew_us;
+    uint64_t sum_skew_us;
+};
+
+typedef struct camera_sync {
+    camera_handle *cams[CAM_SYNC_MAX_CAMS];
+    struct camera_sync_queue queue[CAM_SYNC_MAX_CAMS];
+    int n_cams;
+    uint32_t tolerance_us;
+    int policy;
+    struct camera_sync_stats stats;
+} camera_sync;
+
+int camera_sync_init(camera_sync *sync, camera_handle **cams, int n_cams, uint32_t tolerance_us, int policy);
+void camera_sync_uninit(camera_sync *sync);
+int camera_sync_push(camera_sync *sync, int cam, const uint8_t *data, int size, uint64_t ts_us);
+int camera_sync_pop(camera_sync *sync, struct camera_sync_set *set);
+int camera_sync_capture(camera_sync *sync, struct camera_sync_set *set, int timeout);
+void camera_sync_dump(camera_sync *sync);
+
 #ifdef __cplusplus
 } /*extern "C"*/
 #endif
@@ -0,0 +1,507 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+#include <v853_cam_intf.h>
+
+#define CTRL_ALLOC_STEP 16
+
+static int ctrl_supported(struct v4l2_query_ext_ctrl *q)
+{
+    if (q->flags & V4L2_CTRL_FLAG_DISABLED)
+        return 0;
+    if (q->nr_of_dims)
+        return 0;
+
+    switch (q->type)
+    {
+    case V4L2_CTRL_TYPE_INTEGER:
+    case V4L2_CTRL_TYPE_BOOLEAN:
+    case V4L2_CTRL_TYPE_MENU:
+    case V4L2_CTRL_TYPE_INTEGER_MENU:
+    case V4L2_CTRL_TYPE_BITMASK:
+    case V4L2_CTRL_TYPE_BUTTON:
+    case V4L2_CTRL_TYPE_INTEGER64:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* a cached value can only be trusted if the hardware does not change it */
+static int ctrl_cacheable(struct camera_ctrl *c)
+{
+    if (c->type == V4L2_CTRL_TYPE_BUTTON)
+        return 0;
+    if (c->flags & (V4L2_CTRL_FLAG_VOLATILE | V4L2_CTRL_FLAG_WRITE_ONLY))
+        return 0;
+    return 1;
+}
+
+static int64_t ext_value(struct camera_ctrl *c, struct v4l2_ext_control *ec)
+{
+    if (c->type == V4L2_CTRL_TYPE_INTEGER64)
+        return ec->value64;
+    return ec->value;
+}
+
+static void ext_fill(struct camera_ctrl *c, struct v4l2_ext_control *ec, int64_t value)
+{
+    memset(ec, 0, sizeof(*ec));
+    ec->id = c->id;
+    if (c->type == V4L2_CTRL_TYPE_INTEGER64)
+        ec->value64 = value;
+    else
+        ec->value = (int32_t)value;
+}
+
+static int ctrl_cmp(const void *key, const void *elem)
+{
+    uint32_t id = *(const uint32_t *)key;
+    const struct camera_ctrl *c = elem;
+
+    if (id < c->id)
+        return -1;
+    return id > c->id;
+}
+
+static int ctrl_sort(const void *a, const void *b)
+{
+    const struct camera_ctrl *x = a;
+    const struct camera_ctrl *y = b;
+
+    if (x->id < y->id)
+        return -1;
+    return x->id > y->id;
+}
+
+static int ctrl_read(camera_handle *camera, struct camera_ctrl *c)
+{
+    struct v4l2_ext_controls ext;
+    struct v4l2_ext_control ec;
+
+    ext_fill(c, &ec, 0);
+    memset(&ext, 0, sizeof(ext));
+    ext.which    = V4L2_CTRL_WHICH_CUR_VAL;
+    ext.count    = 1;
+    ext.controls = &ec;
+    if (xioctl(camera->cam_fd, VIDIOC_G_EXT_CTRLS, &ext) < 0)
+    {
+        c->valid = 0;
+        return -1;
+    }
+
+    c->cur   = ext_value(c, &ec);
+    c->valid = 1;
+    return 0;
+}
+
+/**
+ * @brief enumerate the device controls and read their current values.
+ *
+ * Called from camera_init, the metadata stays cached until camera_uninit.
+ *
+ * @param camera camera handle point
+ * @return int number of cached controls, -1 on error
+ */
+int camera_ctrl_init(camera_handle *camera)
+{
+    struct camera_ctrls *ctrls;
+    struct v4l2_query_ext_ctrl q;
+    struct v4l2_ext_controls ext;
+    struct camera_ctrl *c;
+    uint32_t alloc = 0;
+    uint32_t n_read = 0;
+    uint32_t i;
+    void *tmp;
+
+    if (camera == NULL)
+        return -1;
+    ctrls = &camera->ctrls;
+
+    ctrls->ctrl    = NULL;
+    ctrls->batch   = NULL;
+    ctrls->count   = 0;
+    ctrls->n_dirty = 0;
+    if (ctrls->stats.window_start_us == 0)
+        ctrls->stats.window_start_us = camera_now_us();
+
+    memset(&q, 0, sizeof(q));
+    q.id = V4L2_CTRL_FLAG_NEXT_CTRL;
+    while (xioctl(camera->cam_fd, VIDIOC_QUERY_EXT_CTRL, &q) == 0)
+    {
+        if (ctrl_supported(&q))
+        {
+            if (ctrls->count == alloc)
+            {
+                alloc += CTRL_ALLOC_STEP;
+                tmp = realloc(ctrls->ctrl, alloc * sizeof(*ctrls->ctrl));
+                if (tmp == NULL)
+                {
+                    printf("realloc for camera controls failed!\n");
+                    goto FREE_CTRL;
+                }
+                ctrls->ctrl = tmp;
+            }
+
+            c = &ctrls->ctrl[ctrls->count++];
+            memset(c, 0, sizeof(*c));
+            c->id      = q.id;
+            c->type    = q.type;
+            c->flags   = q.flags;
+            c->minimum = q.minimum;
+            c->maximum = q.maximum;
+            c->step    = q.step;
+            c->def     = q.default_value;
+            snprintf(c->name, sizeof(c->name), "%s", q.name);
+        }
+        q.id |= V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND;
+    }
+
+    if (ctrls->count == 0)
+        return 0;
+
+    /* camera_ctrl_find bsearches, the enumeration order is up to the driver */
+    qsort(ctrls->ctrl, ctrls->count, sizeof(*ctrls->ctrl), ctrl_sort);
+
+    ctrls->batch = calloc(ctrls->count, sizeof(*ctrls->batch));
+    if (ctrls->batch == NULL)
+    {
+        printf("calloc for camera control batch failed!\n");
+        goto FREE_CTRL;
+    }
+
+    /* read every readable control in a single ioctl */
+    for (i = 0; i < ctrls->count; i++)
+    {
+        c = &ctrls->ctrl[i];
+        if (c->type == V4L2_CTRL_TYPE_BUTTON || (c->flags & V4L2_CTRL_FLAG_WRITE_ONLY))
+            continue;
+        ext_fill(c, &ctrls->batch[n_read++], 0);
+    }
+
+    memset(&ext, 0, sizeof(ext));
+    ext.which    = V4L2_CTRL_WHICH_CUR_VAL;
+    ext.count    = n_read;
+    ext.controls = ctrls->batch;
+    if (n_read && xioctl(camera->cam_fd, VIDIOC_G_EXT_CTRLS, &ext) == 0)
+    {
+        for (i = 0; i < n_read; i++)
+        {
+            c = camera_ctrl_find(camera, ctrls->batch[i].id);
+            c->cur   = ext_value(c, &ctrls->batch[i]);
+            c->valid = 1;
+        }
+    }
+    else
+    {
+        /* one bad control fails the whole batch, fall back to one by one */
+        for (i = 0; i < n_read; i++)
+            ctrl_read(camera, camera_ctrl_find(camera, ctrls->batch[i].id));
+    }
+
+    printf("camera controls cached: %u\n", ctrls->count);
+
+    return ctrls->count;
+
+FREE_CTRL:
+    free(ctrls->ctrl);
+    ctrls->ctrl  = NULL;
+    ctrls->count = 0;
+
+    return -1;
+}
+
+void camera_ctrl_uninit(camera_handle *camera)
+{
+    if (camera == NULL)
+        return;
+
+    free(camera->ctrls.ctrl);
+    free(camera->ctrls.batch);
+    camera->ctrls.ctrl    = NULL;
+    camera->ctrls.batch   = NULL;
+    camera->ctrls.count   = 0;
+    camera->ctrls.n_dirty = 0;
+}
+
+struct camera_ctrl *camera_ctrl_find(camera_handle *camera, uint32_t id)
+{
+    if (camera == NULL || camera->ctrls.count == 0)
+        return NULL;
+
+    return bsearch(&id, camera->ctrls.ctrl, camera->ctrls.count,
+                   sizeof(*camera->ctrls.ctrl), ctrl_cmp);
+}
+
+/**
+ * @brief get a control value, from the cache unless the control is volatile.
+ *
+ * @param camera camera handle point
+ * @param id V4L2 control id
+ * @param value control value
+ * @return int 0 on success, -1 on error
+ */
+int camera_ctrl_get(camera_handle *camera, uint32_t id, int64_t *value)
+{
+    struct camera_ctrl *c;
+
+    if (value == NULL)
+        return -1;
+
+    c = camera_ctrl_find(camera, id);
+    if (c == NULL)
+    {
+        printf("unknown camera control 0x%08x!\n", id);
+        return -1;
+    }
+
+    if (!ctrl_cacheable(c) || !c->valid)
+    {
+        if (ctrl_read(camera, c) < 0)
+        {
+            printf("read camera control '%s' failed!\n", c->name);
+            return -1;
+        }
+    }
+
+    *value = c->cur;
+    return 0;
+}
+
+/**
+ * @brief stage a control value.
+ *
+ * Nothing is written until camera_ctrl_commit, or until the next dequeued
+ * frame when ctrls.apply_on_frame is set. Values equal to the cached one are
+ * dropped.
+ *
+ * @param camera camera handle point
+ * @param id V4L2 control id
+ * @param value new value, clamped to the control range
+ * @return int 0 on success, -1 on error
+ */
+int camera_ctrl_set(camera_handle *camera, uint32_t id, int64_t value)
+{
+    struct camera_ctrls *ctrls;
+    struct camera_ctrl *c;
+
+    c = camera_ctrl_find(camera, id);
+    if (c == NULL)
+    {
+        printf("unknown camera control 0x%08x!\n", id);
+        return -1;
+    }
+    if (c->flags & V4L2_CTRL_FLAG_READ_ONLY)
+    {
+        printf("camera control '%s' is read only!\n", c->name);
+        return -1;
+    }
+    ctrls = &camera->ctrls;
+
+    if (c->type != V4L2_CTRL_TYPE_BITMASK && c->type != V4L2_CTRL_TYPE_BUTTON)
+    {
+        if (value < c->minimum)
+            value = c->minimum;
+        if (value > c->maximum)
+            value = c->maximum;
+    }
+
+    ctrls->stats.requests++;
+
+    if (ctrl_cacheable(c) && c->valid && value == c->cur)
+    {
+        /* back to the driver value, drop whatever was staged */
+        if (c->dirty)
+        {
+            c->dirty = 0;
+            ctrls->n_dirty--;
+        }
+        ctrls->stats.skipped++;
+        return 0;
+    }
+
+    c->pending = value;
+    if (!c->dirty)
+    {
+        c->dirty = 1;
+        ctrls->n_dirty++;
+    }
+
+    return 0;
+}
+
+/*
+ * write one staged control on its own
+ * args:
+ *   camera - camera handle
+ *   c - staged control
+ *
+ * returns - 0 on success, -1 if the driver refused it, the control is unstaged
+ *           either way
+ */
+static int ctrl_commit_one(camera_handle *camera, struct camera_ctrl *c)
+{
+    struct v4l2_ext_controls ext;
+    struct v4l2_ext_control ec;
+    int rc;
+
+    ext_fill(c, &ec, c->pending);
+    memset(&ext, 0, sizeof(ext));
+    ext.which    = V4L2_CTRL_WHICH_CUR_VAL;
+    ext.count    = 1;
+    ext.controls = &ec;
+    rc           = xioctl(camera->cam_fd, VIDIOC_S_EXT_CTRLS, &ext);
+    camera->ctrls.stats.ioctls++;
+
+    c->dirty = 0;
+    camera->ctrls.n_dirty--;
+    if (rc < 0)
+    {
+        printf("camera control '%s' = %lld rejected: %s\n", c->name, (long long)c->pending, strerror(errno));
+        camera->ctrls.stats.rejected++;
+        c->valid = 0;
+        return -1;
+    }
+
+    c->cur   = ext_value(c, &ec);
+    c->valid = 1;
+    return 0;
+}
+
+/**
+ * @brief write all staged controls with one VIDIOC_S_EXT_CTRLS.
+ *
+ * If the driver rejects the batch during validation nothing was applied, the
+ * controls are then written one by one so a single bad value (busy control,
+ * menu hole, bad bitmask) is dropped instead of blocking the others. After
+ * any other failure the staged values are dropped and re-read on the next get.
+ *
+ * @param camera camera handle point
+ * @return int 0 on success, -1 on error
+ */
+int camera_ctrl_commit(camera_handle *camera)
+{
+    struct camera_ctrls *ctrls;
+    struct v4l2_ext_controls ext;
+    struct camera_ctrl *c;
+    uint32_t n = 0;
+    uint32_t i;
+    int rc;
+
+    if (camera == NULL)
+        return -1;
+    ctrls = &camera->ctrls;
+    if (ctrls->n_dirty == 0)
+        return 0;
+
+    for (i = 0; i < ctrls->count; i++)
+    {
+        c = &ctrls->ctrl[i];
+        if (c->dirty)
+            ext_fill(c, &ctrls->batch[n++], c->pending);
+    }
+
+    memset(&ext, 0, sizeof(ext));
+    ext.which    = V4L2_CTRL_WHICH_CUR_VAL;
+    ext.count    = n;
+    ext.controls = ctrls->batch;
+    rc           = xioctl(camera->cam_fd, VIDIOC_S_EXT_CTRLS, &ext);
+    ctrls->stats.ioctls++;
+    if (rc < 0)
+    {
+        printf("ioctl VIDIOC_S_EXT_CTRLS failed at %u/%u: %s\n", ext.error_idx, n, strerror(errno));
+
+        /* error_idx == count: rejected during validation, nothing was applied */
+        if (ext.error_idx == n)
+        {
+            rc = 0;
+            for (i = 0; i < ctrls->count; i++)
+            {
+                c = &ctrls->ctrl[i];
+                if (c->dirty && ctrl_commit_one(camera, c) < 0)
+                    rc = -1;
+            }
+            return rc;
+        }
+    }
+
+    /* the batch is in id order, same as the table */
+    for (i = 0, n = 0; i < ctrls->count; i++)
+    {
+        c = &ctrls->ctrl[i];
+        if (!c->dirty)
+            continue;
+
+        c->dirty = 0;
+        if (rc < 0)
+        {
+            /* unknown state, make the next set go to the driver */
+            c->valid = 0;
+        }
+        else
+        {
+            /* the driver hands back the value it actually applied */
+            c->cur   = ext_value(c, &ctrls->batch[n]);
+            c->valid = 1;
+        }
+        n++;
+    }
+    ctrls->n_dirty = 0;
+
+    return rc < 0 ? -1 : 0;
+}
+
+/**
+ * @brief frame boundary hook, commits staged controls if apply_on_frame is set.
+ *
+ * @param camera camera handle point
+ * @return int 0 on success, -1 on error
+ */
+int camera_ctrl_frame(camera_handle *camera)
+{
+    if (camera == NULL || !camera->ctrls.apply_on_frame)
+        return 0;
+
+    return camera_ctrl_commit(camera);
+}
+
+void camera_ctrl_dump(camera_handle *camera)
+{
+    struct camera_ctrl_stats *st;
+    struct camera_ctrl *c;
+    uint64_t now;
+    int64_t saved; /* negative when fallback writes cost more than batching saved */
+    float secs;
+    uint32_t i;
+
+    if (camera == NULL)
+        return;
+    st = &camera->ctrls.stats;
+
+    for (i = 0; i < camera->ctrls.count; i++)
+    {
+        c = &camera->ctrls.ctrl[i];
+        printf("{ id: 0x%08x, name: '%s', type: %u, min: %lld, max: %lld, step: %llu, def: %lld, cur: %lld%s }\n",
+               c->id, c->name, c->type, (long long)c->minimum, (long long)c->maximum,
+               (unsigned long long)c->step, (long long)c->def, (long long)c->cur,
+               c->valid ? "" : " (unknown)");
+    }
+
+    now   = camera_now_us();
+    saved = (int64_t)(st->requests - st->window_requests) - (int64_t)(st->ioctls - st->window_ioctls);
+    secs  = (now - st->window_start_us) / 1000000.0;
+
+    printf("ctrl.requests: %llu\n", (unsigned long long)st->requests);
+    printf("ctrl.skipped:  %llu\n", (unsigned long long)st->skipped);
+    printf("ctrl.ioctls:   %llu\n", (unsigned long long)st->ioctls);
+    printf("ctrl.rejected: %llu\n", (unsigned long long)st->rejected);
+    printf("ctrl.saved:    %lld (%.1f ioctl/s)\n", (long long)saved,
+           secs > 0 ? saved / secs : 0.0f);
+
+    st->window_start_us = now;
+    st->window_requests = st->requests;
+    st->window_ioctls   = st->ioctls;
+}
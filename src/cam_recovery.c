@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+#include <v853_cam_intf.h>
+
+#define RECOVER_DEF_MAX_ATTEMPTS 5
+#define RECOVER_DEF_BACKOFF_MS   10
+#define RECOVER_DEF_MAX_BACKOFF  1000
+
+static const char *level_name[CAM_RECOVER_LEVEL_NUM] = {
+    "requeue",
+    "restream",
+    "reopen",
+};
+
+static enum v4l2_buf_type cam_buf_type(camera_handle *camera)
+{
+    if (camera->driver_type == V4L2_CAP_VIDEO_CAPTURE_MPLANE)
+        return V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    return V4L2_BUF_TYPE_VIDEO_CAPTURE;
+}
+
+/*
+ * queue every buffer the driver does not own
+ * args:
+ *   camera - camera handle
+ *   all - queue all buffers without asking the driver first (after STREAMOFF)
+ *
+ * returns - 0 if buffers were queued, -1 on error or if the driver already
+ *           owned all of them (requeue can not help then)
+ */
+static int cam_queue_buffers(camera_handle *camera, int all)
+{
+    struct v4l2_buffer buf;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    uint32_t queued = 0;
+    uint32_t i;
+
+    for (i = 0; i < camera->buf_cnt; i++)
+    {
+        memset(&buf, 0, sizeof(buf));
+        buf.type   = cam_buf_type(camera);
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index  = i;
+        if (camera->driver_type == V4L2_CAP_VIDEO_CAPTURE_MPLANE)
+        {
+            memset(planes, 0, sizeof(planes));
+            buf.length   = camera->nplanes;
+            buf.m.planes = planes;
+        }
+
+        if (!all)
+        {
+            if (xioctl(camera->cam_fd, VIDIOC_QUERYBUF, &buf) < 0)
+            {
+                printf("recover: ioctl VIDIOC_QUERYBUF failed!\n");
+                return -1;
+            }
+            if (buf.flags & (V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE))
+                continue;
+        }
+
+        if (xioctl(camera->cam_fd, VIDIOC_QBUF, &buf) < 0)
+        {
+            printf("recover: ioctl VIDIOC_QBUF[%u] failed!\n", i);
+            return -1;
+        }
+        queued++;
+    }
+
+    return queued ? 0 : -1;
+}
+
+static int cam_restream(camera_handle *camera)
+{
+    enum v4l2_buf_type type = cam_buf_type(camera);
+
+    /* STREAMOFF returns all buffers to userspace, the mappings stay valid */
+    if (xioctl(camera->cam_fd, VIDIOC_STREAMOFF, &type) < 0)
+    {
+        printf("recover: ioctl VIDIOC_STREAMOFF failed!\n");
+        return -1;
+    }
+
+    if (cam_queue_buffers(camera, 1) < 0)
+        return -1;
+
+    if (xioctl(camera->cam_fd, VIDIOC_STREAMON, &type) < 0)
+    {
+        printf("recover: ioctl VIDIOC_STREAMON failed!\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int cam_reopen(camera_handle *camera)
+{
+    camera_stop(camera);
+    camera_uninit(camera);
+
+    /* both unmap, free and close on their error paths, cam_fd ends up -1 */
+    if (camera_init(camera) < 0)
+        return -1;
+    if (camera_start(camera) < 0)
+    {
+        camera_ctrl_uninit(camera);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void cam_backoff(struct camera_recovery_cfg *cfg, uint32_t attempt)
+{
+    uint32_t delay = cfg->backoff_ms;
+    uint32_t i;
+
+    /* the first attempt runs right away, then base, 2 * base, 4 * base ... */
+    if (attempt <= 1)
+        return;
+
+    for (i = 2; i < attempt && delay < cfg->max_backoff_ms; i++)
+        delay <<= 1;
+    if (delay > cfg->max_backoff_ms)
+        delay = cfg->max_backoff_ms;
+
+    usleep(delay * 1000);
+}
+
+/**
+ * @brief bring a failed stream back, cheapest action first.
+ *
+ * Each call escalates from where the previous one stopped until a good
+ * frame resets the attempt counter (see camera_recovery_frame_ok).
+ *
+ * @param camera camera handle point
+ * @return int 0 if the stream was restarted and capture may be retried,
+ *             -1 once max_attempts is reached
+ */
+int camera_recover(camera_handle *camera)
+{
+    struct camera_recovery *rec;
+    enum camera_recover_level level;
+    int rc;
+
+    if (camera == NULL)
+        return -1;
+    rec = &camera->recovery;
+
+    if (rec->cfg.max_attempts == 0)
+        rec->cfg.max_attempts = RECOVER_DEF_MAX_ATTEMPTS;
+    if (rec->cfg.backoff_ms == 0)
+        rec->cfg.backoff_ms = RECOVER_DEF_BACKOFF_MS;
+    if (rec->cfg.max_backoff_ms == 0)
+        rec->cfg.max_backoff_ms = RECOVER_DEF_MAX_BACKOFF;
+
+    if (rec->fail_start_us == 0)
+        rec->fail_start_us = camera_now_us();
+
+    while (rec->attempts < rec->cfg.max_attempts)
+    {
+        rec->attempts++;
+        cam_backoff(&rec->cfg, rec->attempts);
+
+        level = rec->attempts - 1;
+        if (level > CAM_RECOVER_REOPEN)
+            level = CAM_RECOVER_REOPEN;
+        /* nothing to talk to, skip straight to reopening the device */
+        if (camera->cam_fd < 0)
+            level = CAM_RECOVER_REOPEN;
+
+        printf("camera recover attempt %u/%u: %s\n",
+               rec->attempts, rec->cfg.max_attempts, level_name[level]);
+
+        switch (level)
+        {
+        case CAM_RECOVER_REQUEUE:
+            rc = cam_queue_buffers(camera, 0);
+            break;
+        case CAM_RECOVER_RESTREAM:
+            rc = cam_restream(camera);
+            break;
+        default:
+            rc = cam_reopen(camera);
+            break;
+        }
+
+        /* only counted once a frame actually shows up */
+        if (rc == 0)
+        {
+            rec->pending       = 1;
+            rec->pending_level = level;
+            return 0;
+        }
+    }
+
+    rec->stats.failures++;
+    rec->attempts = 0;
+    rec->pending  = 0;
+    printf("camera recover gave up after %u attempts!\n", rec->cfg.max_attempts);
+
+    return -1;
+}
+
+/**
+ * @brief mark a frame as received, closes a pending outage.
+ *
+ * The outage runs from the previous good frame, not from the first failure,
+ * which is only noticed after the capture timeout.
+ *
+ * @param camera camera handle point
+ */
+void camera_recovery_frame_ok(camera_handle *camera)
+{
+    struct camera_recovery *rec = &camera->recovery;
+    uint64_t now = camera_now_us();
+    uint64_t outage;
+
+    rec->attempts = 0;
+    if (rec->fail_start_us == 0)
+    {
+        rec->last_frame_us = now;
+        return;
+    }
+
+    if (rec->pending)
+    {
+        rec->stats.recoveries++;
+        rec->stats.by_level[rec->pending_level]++;
+        rec->stats.last_recovery_us = now - rec->fail_start_us;
+        printf("camera recovered by %s in %llu us\n", level_name[rec->pending_level],
+               (unsigned long long)rec->stats.last_recovery_us);
+        rec->pending = 0;
+    }
+
+    outage = now - (rec->last_frame_us ? rec->last_frame_us : rec->fail_start_us);
+    rec->last_frame_us = now;
+    rec->fail_start_us = 0;
+
+    rec->stats.last_outage_us = outage;
+    rec->stats.total_outage_us += outage;
+    if (outage > rec->stats.max_outage_us)
+        rec->stats.max_outage_us = outage;
+    printf("camera stream outage: %llu us\n", (unsigned long long)outage);
+}
+
+void camera_recovery_dump(camera_handle *camera)
+{
+    struct camera_recovery_stats *st;
+    int i;
+
+    if (camera == NULL)
+        return;
+    st = &camera->recovery.stats;
+
+    printf("recovery.recoveries:   %u\n", st->recoveries);
+    printf("recovery.failures:     %u\n", st->failures);
+    for (i = 0; i < CAM_RECOVER_LEVEL_NUM; i++)
+        printf("recovery.%s: %u\n", level_name[i], st->by_level[i]);
+    printf("recovery.last_time:    %llu us\n", (unsigned long long)st->last_recovery_us);
+    printf("recovery.last_outage:  %llu us\n", (unsigned long long)st->last_outage_us);
+    printf("recovery.max_outage:   %llu us\n", (unsigned long long)st->max_outage_us);
+    printf("recovery.total_outage: %llu us\n", (unsigned long long)st->total_outage_us);
+}
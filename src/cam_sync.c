@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/select.h>
+
+#include <v853_cam_intf.h>
+
+static struct camera_sync_frame *queue_head(struct camera_sync_queue *q)
+{
+    return &q->slot[q->head];
+}
+
+static void queue_pop(struct camera_sync_queue *q)
+{
+    q->head = (q->head + 1) % CAM_SYNC_DEPTH;
+    q->count--;
+}
+
+/*
+ * get the slot the next frame of a camera goes to
+ * args:
+ *   sync - synchronizer
+ *   q - queue of the camera
+ *
+ * returns - free slot, older frames are dropped according to the policy
+ */
+static struct camera_sync_frame *queue_reserve(camera_sync *sync, struct camera_sync_queue *q)
+{
+    /* pop runs after every push, whatever is still queued had no partner */
+    if (sync->policy == CAM_SYNC_DROP)
+    {
+        while (q->count)
+        {
+            queue_pop(q);
+            q->dropped++;
+        }
+    }
+    else if (q->count == CAM_SYNC_DEPTH)
+    {
+        queue_pop(q);
+        q->dropped++;
+    }
+
+    return &q->slot[(q->head + q->count) % CAM_SYNC_DEPTH];
+}
+
+static void queue_commit(struct camera_sync_queue *q, int size, uint64_t ts_us)
+{
+    struct camera_sync_frame *f = &q->slot[(q->head + q->count) % CAM_SYNC_DEPTH];
+
+    f->size  = size;
+    f->ts_us = ts_us;
+    q->count++;
+    q->frames++;
+}
+
+/**
+ * @brief set up a synchronizer over already initialized cameras.
+ *
+ * @param sync synchronizer
+ * @param cams camera handles, started or about to be started
+ * @param n_cams number of cameras, up to CAM_SYNC_MAX_CAMS
+ * @param tolerance_us max timestamp distance inside a matched set
+ * @param policy enum camera_sync_policy
+ * @return int 0 on success, -1 on error
+ */
+int camera_sync_init(camera_sync *sync, camera_handle **cams, int n_cams, uint32_t tolerance_us, int policy)
+{
+    struct camera_sync_queue *q;
+    int i, j;
+
+    if (sync == NULL || cams == NULL)
+        return -1;
+    if (n_cams < 2 || n_cams > CAM_SYNC_MAX_CAMS)
+    {
+        printf("camera sync supports 2..%d cameras, got %d!\n", CAM_SYNC_MAX_CAMS, n_cams);
+        return -1;
+    }
+
+    memset(sync, 0, sizeof(*sync));
+    sync->n_cams       = n_cams;
+    sync->tolerance_us = tolerance_us;
+    sync->policy       = policy;
+
+    for (i = 0; i < n_cams; i++)
+    {
+        if (cams[i] == NULL || cams[i]->buffers == NULL)
+        {
+            printf("camera sync: camera %d not initialized!\n", i);
+            goto FREE_SLOT;
+        }
+        sync->cams[i] = cams[i];
+
+        /* camera_cap_frame copies plane 0 of one mapped buffer */
+        q            = &sync->queue[i];
+        q->slot_size = cams[i]->buffers[0].length[0];
+        for (j = 0; j < CAM_SYNC_DEPTH; j++)
+        {
+            q->slot[j].data = malloc(q->slot_size);
+            if (q->slot[j].data == NULL)
+            {
+                printf("malloc for camera sync slot failed!\n");
+                goto FREE_SLOT;
+            }
+        }
+    }
+
+    return 0;
+
+FREE_SLOT:
+    camera_sync_uninit(sync);
+
+    return -1;
+}
+
+void camera_sync_uninit(camera_sync *sync)
+{
+    int i, j;
+
+    if (sync == NULL)
+        return;
+
+    for (i = 0; i < CAM_SYNC_MAX_CAMS; i++)
+    {
+        for (j = 0; j < CAM_SYNC_DEPTH; j++)
+        {
+            free(sync->queue[i].slot[j].data);
+            sync->queue[i].slot[j].data = NULL;
+        }
+    }
+}
+
+/**
+ * @brief feed a frame captured outside the synchronizer.
+ *
+ * @param sync synchronizer
+ * @param cam camera index as passed to camera_sync_init
+ * @param data frame data, copied
+ * @param size frame size
+ * @param ts_us capture timestamp, same clock for every camera
+ * @return int 0 on success, -1 on error
+ */
+int camera_sync_push(camera_sync *sync, int cam, const uint8_t *data, int size, uint64_t ts_us)
+{
+    struct camera_sync_queue *q;
+    struct camera_sync_frame *f;
+
+    if (sync == NULL || data == NULL || cam < 0 || cam >= sync->n_cams)
+        return -1;
+
+    q = &sync->queue[cam];
+    if (size < 0 || (size_t)size > q->slot_size)
+    {
+        printf("camera sync: frame size %d exceeds slot size %zu!\n", size, q->slot_size);
+        return -1;
+    }
+
+    f = queue_reserve(sync, q);
+    memcpy(f->data, data, size);
+    queue_commit(q, size, ts_us);
+
+    return 0;
+}
+
+/**
+ * @brief take the next matched set if there is one.
+ *
+ * Queues are ordered by timestamp, so whenever the oldest head is more than
+ * tolerance_us behind the newest head it can never be matched and is dropped.
+ *
+ * @param sync synchronizer
+ * @param set matched frames, one per camera
+ * @return int 1 if a set was emitted, 0 if more frames are needed, -1 on error
+ */
+int camera_sync_pop(camera_sync *sync, struct camera_sync_set *set)
+{
+    struct camera_sync_frame *f;
+    uint64_t min_ts, max_ts, skew;
+    int min_cam;
+    int i;
+
+    if (sync == NULL || set == NULL)
+        return -1;
+
+    while (1)
+    {
+        min_ts  = UINT64_MAX;
+        max_ts  = 0;
+        min_cam = 0;
+        for (i = 0; i < sync->n_cams; i++)
+        {
+            if (sync->queue[i].count == 0)
+                return 0;
+
+            f = queue_head(&sync->queue[i]);
+            if (f->ts_us < min_ts)
+            {
+                min_ts  = f->ts_us;
+                min_cam = i;
+            }
+            if (f->ts_us > max_ts)
+                max_ts = f->ts_us;
+        }
+
+        skew = max_ts - min_ts;
+        if (skew <= sync->tolerance_us)
+            break;
+
+        queue_pop(&sync->queue[min_cam]);
+        sync->queue[min_cam].dropped++;
+    }
+
+    memset(set, 0, sizeof(*set));
+    for (i = 0; i < sync->n_cams; i++)
+    {
+        set->frame[i] = queue_head(&sync->queue[i]);
+        queue_pop(&sync->queue[i]);
+    }
+    set->ts_us   = min_ts;
+    set->skew_us = skew;
+
+    sync->stats.sets++;
+    sync->stats.last_skew_us = skew;
+    sync->stats.sum_skew_us += skew;
+    if (skew > sync->stats.max_skew_us)
+        sync->stats.max_skew_us = skew;
+
+    return 1;
+}
+
+/**
+ * @brief capture from all cameras until a matched set is available.
+ *
+ * A camera that stays silent for timeout seconds while the others keep
+ * delivering is read directly, so its capture times out and recovery runs
+ * instead of the loop spinning on the live cameras forever.
+ *
+ * @param sync synchronizer
+ * @param set matched frames, one per camera
+ * @param timeout select timeout in seconds while no camera has a frame
+ * @return int 1 if a set was emitted, 0 on timeout, -1 on error
+ */
+int camera_sync_capture(camera_sync *sync, struct camera_sync_set *set, int timeout)
+{
+    struct camera_sync_queue *q;
+    struct camera_sync_frame *f;
+    struct timeval tv;
+    fd_set fds;
+    uint64_t ts_us;
+    uint64_t start_us, since_us, now_us;
+    int max_fd;
+    int size;
+    int rc;
+    int i;
+
+    if (sync == NULL || set == NULL)
+        return -1;
+
+    /* silence is only counted from this call on, not across idle callers */
+    start_us = camera_now_us();
+
+    while (1)
+    {
+        FD_ZERO(&fds);
+        max_fd = -1;
+        for (i = 0; i < sync->n_cams; i++)
+        {
+            if (sync->cams[i]->cam_fd < 0)
+            {
+                printf("camera sync: camera %d is not open!\n", i);
+                return -1;
+            }
+            FD_SET(sync->cams[i]->cam_fd, &fds);
+            if (sync->cams[i]->cam_fd > max_fd)
+                max_fd = sync->cams[i]->cam_fd;
+        }
+
+        /* time out */
+        tv.tv_sec  = timeout;
+        tv.tv_usec = 0;
+
+        rc = select(max_fd + 1, &fds, NULL, NULL, &tv);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc < 0)
+        {
+            printf("camera sync: select error!\n");
+            return -1;
+        }
+        else if (rc == 0)
+        {
+            printf("camera sync: select time out..\n");
+            return 0;
+        }
+
+        for (i = 0; i < sync->n_cams; i++)
+        {
+            q = &sync->queue[i];
+            if (!FD_ISSET(sync->cams[i]->cam_fd, &fds))
+            {
+                since_us = q->last_us > start_us ? q->last_us : start_us;
+                now_us   = camera_now_us();
+                if (now_us - since_us < (uint64_t)timeout * 1000000)
+                    continue;
+                printf("camera sync: camera %d silent for %llu us\n",
+                       i, (unsigned long long)(now_us - since_us));
+            }
+
+            /*
+             * a readable fd makes the first select return at once, the real
+             * timeout matters for a silent camera and for the retries after
+             * a recovery
+             */
+            f  = queue_reserve(sync, q);
+            rc = camera_cap_frame(sync->cams[i], f->data, &size, &ts_us, timeout);
+            if (rc < 0)
+                return -1;
+            queue_commit(q, size, ts_us);
+            q->last_us = camera_now_us();
+        }
+
+        rc = camera_sync_pop(sync, set);
+        if (rc != 0)
+            return rc;
+    }
+}
+
+void camera_sync_dump(camera_sync *sync)
+{
+    struct camera_sync_queue *q;
+    uint64_t frames = 0;
+    int i;
+
+    if (sync == NULL)
+        return;
+
+    for (i = 0; i < sync->n_cams; i++)
+    {
+        q = &sync->queue[i];
+        frames += q->frames;
+        printf("sync.cam[%d]: frames: %llu, dropped: %llu, queued: %u, match rate: %.1f%%\n",
+               i, (unsigned long long)q->frames, (unsigned long long)q->dropped, q->count,
+               q->frames ? 100.0 * sync->stats.sets / q->frames : 0.0);
+    }
+
+    printf("sync.sets:       %llu\n", (unsigned long long)sync->stats.sets);
+    printf("sync.match_rate: %.1f%%\n",
+           frames ? 100.0 * sync->stats.sets * sync->n_cams / frames : 0.0);
+    printf("sync.skew:       last %llu us, avg %llu us, max %llu us\n",
+           (unsigned long long)sync->stats.last_skew_us,
+           (unsigned long long)(sync->stats.sets ? sync->stats.sum_skew_us / sync->stats.sets : 0),
+           (unsigned long long)sync->stats.max_skew_us);
+}
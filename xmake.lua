@@ -8,6 +8,11 @@ target("v853_camera")
     add_files("src/*.c")
     add_includedirs("inc")
 
+target("v853_bench")
+    set_kind("binary")
+    add_files("src/*.c|main.c", "bench/*.c")
+    add_includedirs("inc")
+
 --
 -- If you want to known more usage about xmake, please see https://xmake.io
 --